@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "vector_field.h"
+
+// 串流輸出：每條線積分完就寫出，記憶體用量與總線數無關
+// points 直接寫進輸出檔，每條線的資料 (點數, seed_grad, 長度) 暫存在 tmpfile，
+// close() 時再接到檔尾並回填檔頭的數量，所以輸出必須是可以 seek 的檔案 (不能是 pipe)。
+enum class export_format{ vtk, ply, raw };
+
+class streamline_writer{
+public:
+    virtual ~streamline_writer();
+
+    // 可以重複使用，但每次 open() 前要先 close()
+    bool open(const std::string &path);
+    void add_line(const std::vector<glm::vec2> &pts, float seed_grad);
+    bool close();
+
+    uint64_t get_line_count() const{ return line_cnt; }
+    uint64_t get_point_count() const{ return point_cnt; }
+    bool has_failed() const{ return failed; }
+
+protected:
+    struct line_record{
+        uint64_t vert_cnt;
+        float seed_grad;
+        float length;
+    };
+
+    // open() 時清掉上一個檔案的狀態，子類別有自己的計數要 override
+    virtual void reset();
+    // 檔頭長度必須固定，open() 先寫 0，close() 再回填
+    virtual void write_header() = 0;
+    virtual void write_points(const std::vector<glm::vec2> &pts, float seed_grad) = 0;
+    virtual void write_tail() = 0;
+
+    // 逐塊讀回暫存的 line_record
+    template<typename F>
+    void for_each_record(F &&fn);
+
+    std::string path;
+    FILE *out = nullptr;
+    FILE *spill = nullptr;
+    bool failed = false;    // 設了之後不再寫入，close() 會刪掉輸出檔
+    uint64_t line_cnt = 0;
+    uint64_t point_cnt = 0;
+    std::vector<float> scratch;
+};
+
+// VTK XML PolyData (.vtp)，appended raw binary
+class vtk_writer : public streamline_writer{
+protected:
+    void write_header() override;
+    void write_points(const std::vector<glm::vec2> &pts, float seed_grad) override;
+    void write_tail() override;
+};
+
+// binary PLY：vertex(x, y, z, seed_grad, line) + edge(vertex1, vertex2)
+// index 都是 uint，超過 2^32 個點或線就放棄，改用 .vtp / .slr
+class ply_writer : public streamline_writer{
+protected:
+    void reset() override;
+    void write_header() override;
+    void write_points(const std::vector<glm::vec2> &pts, float seed_grad) override;
+    void write_tail() override;
+private:
+    uint64_t edge_cnt = 0;
+};
+
+// 自訂 raw 格式 (.slr)，byte order 同主機 (x86/ARM 為 little endian)：
+//   char     magic[8]             "SLRAW01\0"
+//   uint64   line_cnt, point_cnt
+//   float32  points[point_cnt][2]
+//   uint64   offsets[line_cnt + 1]
+//   float32  seed_grad[line_cnt]
+//   float32  length[line_cnt]
+class raw_writer : public streamline_writer{
+protected:
+    void write_header() override;
+    void write_points(const std::vector<glm::vec2> &pts, float seed_grad) override;
+    void write_tail() override;
+};
+
+std::unique_ptr<streamline_writer> make_streamline_writer(export_format fmt);
+bool parse_export_format(const std::string &name, export_format &fmt);
+export_format export_format_from_path(const std::string &path);
+const char *export_format_ext(export_format fmt);
+
+// 依 seed grid 積分並直接寫出，不經過 VBO
+bool export_streamlines(const vector_field &vf, const std::string &path, export_format fmt,
+    int seed_cols, int seed_rows, float h, int maxSteps);
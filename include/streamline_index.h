@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+// streamline 線段的 uniform grid，給 hover / 框選用
+// base 層是 CSR (cell_start + cell_segs)，build() 時平行建好，線段以起點的 vertex index 表示。
+// 格子至少和線段平均長度一樣大，線段只放進它實際穿過的格子。
+// update_line() 改過的線放到 patch 層，base 裡的舊線段以 dirty 標記略過；
+// patch 累積太多時整個重建；重建只重排 index 自己的點，VBO 的範圍另外記在 vbo_first / vbo_cnt。
+class streamline_index{
+public:
+    // verts 必須和 VBO 的內容一致
+    void build(std::vector<glm::vec2> verts, const std::vector<int> &vert_cnt,
+        float w, float h);
+    // 之後 get_line_range() 對這條線回傳 (-1, 0)，直到下一次 build()
+    void update_line(int line, std::vector<glm::vec2> new_pts);
+
+    // max_dist 內最近的線，找不到回傳 -1；從 p 的格子一圈圈往外找
+    int nearest_line(glm::vec2 p, float max_dist, float *out_dist = nullptr) const;
+    // 有任何線段穿過矩形的線，已排序；用到 seen stamp，不能多個 thread 同時呼叫
+    std::vector<int> lines_in_rect(glm::vec2 a, glm::vec2 b) const;
+
+    int get_line_count() const{ return (int) line_first.size(); }
+    // build() 時在 VBO 中的 (first, count)；update_line() 改過的線回傳 (-1, 0)
+    std::pair<int, int> get_line_range(int line) const;
+    // 目前的點 (含 update_line 的結果)
+    std::pair<const glm::vec2 *, int> get_line_points(int line) const;
+    float get_line_length(int line) const;
+
+private:
+    template<typename F>
+    void for_each_cell(glm::vec2 lo, glm::vec2 hi, F &&fn) const;
+    // 線段實際經過的格子 (不是整個 AABB)
+    template<typename F>
+    void for_each_seg_cell(glm::vec2 a, glm::vec2 b, F &&fn) const;
+    void build_grid(std::vector<glm::vec2> verts, const std::vector<int> &vert_cnt);
+    void insert_patch(int line);
+    void erase_patch(int line);
+
+    float field_w = 0.0f, field_h = 0.0f;
+    float cell_size = 1.0f, inv_cell = 1.0f;
+    int nx = 0, ny = 0;
+    size_t base_seg_cnt = 0;
+
+    std::vector<glm::vec2> pts;
+    std::vector<int> line_first, line_cnt;
+    std::vector<uint32_t> vert_line;
+    std::vector<uint32_t> cell_start, cell_segs;
+
+    std::vector<int> vbo_first, vbo_cnt;
+    std::vector<char> dirty;
+    std::vector<char> vbo_stale;
+    std::unordered_map<int, std::vector<glm::vec2>> patch_pts;
+    std::unordered_map<int, std::vector<std::pair<int, int>>> patch_cells; // cell -> (line, seg)
+    size_t patch_seg_cnt = 0;
+
+    // lines_in_rect 用，每條線只收一次
+    mutable std::vector<uint32_t> seen;
+    mutable uint32_t seen_gen = 0;
+};
@@ -1,3 +1,4 @@
+#pragma once
 #include <vector>
 #include <string>
 #include <cmath>
@@ -7,7 +8,7 @@
 
 class vector_field{
 private:
-    int w, h;
+    int w = 0, h = 0;
     std::vector<std::vector<glm::vec2>> vectors, gradients; // 2D vector field
     glm::vec2 sample_value(int x, int y) const;
     glm::vec2 compute_point_gradient(int x, int y);
@@ -21,6 +22,7 @@ public:
     const int get_width() const;
     const int get_height() const;
     const glm::vec2 get_min_max() const;
+    float seed_gradient(glm::vec2 seed) const; // seed 所在格點的 gradient 大小
     const std::vector<std::vector<glm::vec2>> &get_gradients() const;
     const std::vector<std::vector<glm::vec2>> &get_vector() const;
 };
@@ -16,12 +16,19 @@
 #include "imgui_impl_opengl3.h"
 
 #include <future>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <chrono>
 #include "lic.h"
+#include "streamline_export.h"
+#include "streamline_index.h"
 
 int width = 800, height = 600;
 
 GLuint streamline_vao = 0, streamline_vbo = 0;
 GLuint quad_vao = 0, quad_vbo = 0;
+GLuint brush_vao = 0, brush_vbo = 0;
 
 size_t streamline_vert_cnt = 0;
 GLuint noise_tex = 0, vect_tex = 0;
@@ -37,6 +44,7 @@ vector_field vf;
 
 std::vector<GLsizei> line_vert_cnt;
 std::vector<float> seed_grad;
+streamline_index sl_index;
 
 
 void reshape(GLFWwindow *window, int w, int h){
@@ -69,7 +77,6 @@ void rebuild_streamlines(const vector_field &vf){
 
     line_vert_cnt.clear();
     seed_grad.clear();                     // ← 清空旧数据
-    const auto &G = vf.get_gradients();         // 取引用
 
     for(int j = 0; j < seed_rows; j++){
         float fy = (j + 0.5f) * vf.get_height() / float(seed_rows);
@@ -80,10 +87,7 @@ void rebuild_streamlines(const vector_field &vf){
             line_vert_cnt.push_back((GLsizei) line.size());
             for(auto &p : line)  all_verts.push_back(p);
 
-            int gi = glm::clamp(int(fy), 0, vf.get_height() - 1);
-            int gj = glm::clamp(int(fx), 0, vf.get_width() - 1);
-            float mag = glm::length(G[gi][gj]);
-            seed_grad.push_back(mag);
+            seed_grad.push_back(vf.seed_gradient({ fx, fy }));
         }
     }
 
@@ -102,6 +106,35 @@ void rebuild_streamlines(const vector_field &vf){
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
         sizeof(glm::vec2), (void *) 0);
     glBindVertexArray(0);
+
+    sl_index.build(std::move(all_verts), line_vert_cnt,
+        float(vf.get_width()), float(vf.get_height()));
+}
+
+// 框選中的矩形，每幀只更新 4 個點
+void draw_brush(const Shader &shader, const glm::mat4 &mvp, glm::vec2 a, glm::vec2 b){
+    glm::vec2 rect[4] = { a, { b.x, a.y }, b, { a.x, b.y } };
+    if(brush_vao == 0){
+        glGenVertexArrays(1, &brush_vao);
+        glGenBuffers(1, &brush_vbo);
+        glBindVertexArray(brush_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, brush_vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(rect), nullptr, GL_DYNAMIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
+            sizeof(glm::vec2), (void *) 0);
+    }
+    glBindVertexArray(brush_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, brush_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(rect), rect);
+
+    shader.use();
+    shader.set_mat4("uMVP", mvp);
+    shader.set_vec3("uColor", glm::vec3(0.0f, 1.0f, 0.0f));
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_LINE_LOOP, 0, 4);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(0);
 }
 
 void init_data(){
@@ -119,7 +152,75 @@ void init_data(){
 }
 
 
+// 整個字串都要是正數才算數
+bool parse_positive(const char *s, int &v){
+    char *end = nullptr;
+    long x = std::strtol(s, &end, 10);
+    if(end == s || *end != '\0' || x <= 0 || x > INT_MAX) return false;
+    v = int(x);
+    return true;
+}
+
+bool parse_positive(const char *s, float &v){
+    char *end = nullptr;
+    float x = std::strtof(s, &end);
+    if(end == s || *end != '\0' || !(x > 0.0f) || !std::isfinite(x)) return false;
+    v = x;
+    return true;
+}
+
+// 不開視窗，直接把 streamline 串流寫到檔案
+// Hw1 --export out.vtp [--format vtk|ply|raw] [--field Vector/9.vec]
+//     [--seeds cols rows] [--step h] [--max-steps n]
+int run_headless_export(int argc, char **argv){
+    std::string out_path, field_path = "Vector/9.vec";
+    std::string fmt_name;
+    int cols = 0, rows = 0;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        int first = i;
+        bool has_next = i + 1 < argc;
+        bool ok = true;
+        if(arg == "--export" && has_next) out_path = argv[++i];
+        else if(arg == "--format" && has_next) fmt_name = argv[++i];
+        else if(arg == "--field" && has_next) field_path = argv[++i];
+        else if(arg == "--step" && has_next) ok = parse_positive(argv[++i], step_size);
+        else if(arg == "--max-steps" && has_next) ok = parse_positive(argv[++i], max_steps);
+        else if(arg == "--seeds" && i + 2 < argc){
+            ok = parse_positive(argv[i + 1], cols) && parse_positive(argv[i + 2], rows);
+            i += 2;
+        }
+        else ok = false;
+        if(!ok){
+            std::cerr << "Unknown, incomplete or invalid argument:";
+            for(int k = first; k <= i && k < argc; k++) std::cerr << " " << argv[k];
+            std::cerr << std::endl;
+            return -1;
+        }
+    }
+
+    export_format fmt = export_format_from_path(out_path);
+    if(!fmt_name.empty() && !parse_export_format(fmt_name, fmt)){
+        std::cerr << "Unknown export format: " << fmt_name << std::endl;
+        return -1;
+    }
+
+    vf = vector_field(field_path);
+    if(vf.get_width() <= 0 || vf.get_height() <= 0) return -1;
+    seed_cols = cols > 0 ? cols : vf.get_width();
+    seed_rows = rows > 0 ? rows : vf.get_height();
+
+    return export_streamlines(vf, out_path, fmt, seed_cols, seed_rows, step_size, max_steps) ? 0 : -1;
+}
+
+
 int main(int argc, char **argv){
+    for(int i = 1; i < argc; i++){
+        if(std::strcmp(argv[i], "--export") == 0){
+            return run_headless_export(argc, argv);
+        }
+    }
+
     glutInit(&argc, argv);
     if(!glfwInit()){
         return -1;
@@ -178,6 +279,14 @@ int main(int argc, char **argv){
     bool  flip_y = false;
     bool show_lic = true;
     bool show_sl = true;
+    char export_path[256] = "streamlines.vtp";
+    std::string export_status;
+
+    int hovered_line = -1;
+    std::vector<int> selected_lines;
+    bool brushing = false;
+    glm::vec2 brush_start(0.0f);
+    float pick_us = 0.0f, brush_us = 0.0f;
 
     glm::vec2 mm = vf.get_min_max();
     float gmin = mm.x, gmax = mm.y;
@@ -207,6 +316,8 @@ int main(int argc, char **argv){
             prev_step = step_size;
             prev_max = max_steps;
             rebuild_streamlines(vf);
+            hovered_line = -1;
+            selected_lines.clear();
         }
         ImGui::End();
 
@@ -220,6 +331,29 @@ int main(int argc, char **argv){
         ImGui::Checkbox("Show Steam Line", &show_sl);
         ImGui::End();
 
+        ImGui::Begin("Export");
+        ImGui::InputText("Path", export_path, sizeof(export_path));
+        // 格式跟副檔名走，和 headless 模式一致；選 combo 時改副檔名
+        int export_fmt = (int) export_format_from_path(export_path);
+        if(ImGui::Combo("Format", &export_fmt, "VTK (.vtp)\0PLY (.ply)\0Raw (.slr)\0")){
+            std::string p = export_path;
+            size_t dot = p.find_last_of('.');
+            size_t slash = p.find_last_of("/\\");
+            if(dot != std::string::npos && (slash == std::string::npos || dot > slash)) p.erase(dot);
+            p += std::string(".") + export_format_ext((export_format) export_fmt);
+            snprintf(export_path, sizeof(export_path), "%s", p.c_str());
+        }
+        if(ImGui::Button("Export Streamlines")){
+            bool ok = export_streamlines(vf, export_path, (export_format) export_fmt,
+                seed_cols, seed_rows, step_size, max_steps);
+            export_status = ok ? std::string("Exported to ") + export_path
+                : std::string("Export failed, see console");
+        }
+        if(!export_status.empty()){
+            ImGui::TextUnformatted(export_status.c_str());
+        }
+        ImGui::End();
+
 
         glm::mat4 model(1.0f);
         float cx = vf.get_width() * 0.5f;
@@ -235,6 +369,62 @@ int main(int argc, char **argv){
         model = glm::translate(model, { -cx, -cy, 0.0f });
         glm::mat4 mvp = proj * model;
 
+        // 滑鼠轉回場的座標：hover 找最近的線，Shift + 拖曳框選
+        double mx, my;
+        glfwGetCursorPos(window, &mx, &my);
+        GLint vp[4];
+        glGetIntegerv(GL_VIEWPORT, vp);
+        glm::vec4 ndc(2.0f * (float(mx) - vp[0]) / vp[2] - 1.0f,
+            2.0f * (float(height - my) - vp[1]) / vp[3] - 1.0f, 0.0f, 1.0f);
+        glm::vec4 fp = glm::inverse(mvp) * ndc;
+        glm::vec2 cursor(fp.x, fp.y);
+        float px = std::max(vf.get_width() / float(vp[2]), vf.get_height() / float(vp[3]));
+        bool vp_ok = vp[2] > 0 && vp[3] > 0;
+        bool lmb = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+
+        if(!io.WantCaptureMouse && vp_ok){
+            auto t0 = std::chrono::steady_clock::now();
+            hovered_line = sl_index.nearest_line(cursor, 5.0f * px);
+            auto t1 = std::chrono::steady_clock::now();
+            pick_us = std::chrono::duration<float, std::micro>(t1 - t0).count();
+
+            bool shift = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ||
+                glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS;
+            if(lmb && shift && !brushing){
+                brushing = true;
+                brush_start = cursor;
+            }
+        }
+        // 放開就結束框選，就算滑鼠停在 ImGui 視窗上；視窗縮到 0 則取消
+        if(brushing && (!lmb || !vp_ok)){
+            brushing = false;
+            if(vp_ok){
+                auto t2 = std::chrono::steady_clock::now();
+                selected_lines = sl_index.lines_in_rect(brush_start, cursor);
+                auto t3 = std::chrono::steady_clock::now();
+                brush_us = std::chrono::duration<float, std::micro>(t3 - t2).count();
+            }
+        }
+
+        ImGui::Begin("Pick");
+        ImGui::Text("Hover a line, Shift + drag to select");
+        if(hovered_line >= 0){
+            glm::vec2 seed = sl_index.get_line_points(hovered_line).first[0];
+            ImGui::Text("Line %d", hovered_line);
+            ImGui::Text("Seed (%.2f, %.2f)", seed.x, seed.y);
+            ImGui::Text("Length %.3f", sl_index.get_line_length(hovered_line));
+            ImGui::Text("Gradient %.4f", seed_grad[hovered_line]);
+        }
+        else{
+            ImGui::Text("Line -");
+        }
+        ImGui::Text("Pick %.1f us", pick_us);
+        ImGui::Text("Selected %d lines (%.1f us)", (int) selected_lines.size(), brush_us);
+        if(ImGui::Button("Clear Selection")){
+            selected_lines.clear();
+        }
+        ImGui::End();
+
         // LIC
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glClearColor(0.7f, 0.7f, 0.7f, 1.0f);
@@ -288,9 +478,27 @@ int main(int argc, char **argv){
                 glDrawArrays(GL_LINE_STRIP, offset, line_vert_cnt[k]);
                 offset += line_vert_cnt[k];
             }
+
+            // 高亮只重畫 VBO 裡那段，不重新上傳
+            glDisable(GL_DEPTH_TEST);
+            streamline_shader.set_vec3("uColor", glm::vec3(1.0f, 1.0f, 1.0f));
+            for(int k : selected_lines){
+                auto range = sl_index.get_line_range(k);
+                if(range.second > 0) glDrawArrays(GL_LINE_STRIP, range.first, range.second);
+            }
+            if(hovered_line >= 0){
+                auto range = sl_index.get_line_range(hovered_line);
+                streamline_shader.set_vec3("uColor", glm::vec3(1.0f, 1.0f, 0.0f));
+                if(range.second > 0) glDrawArrays(GL_LINE_STRIP, range.first, range.second);
+            }
+            glEnable(GL_DEPTH_TEST);
         }
         glBindVertexArray(0);
 
+        if(brushing){
+            draw_brush(streamline_shader, mvp, brush_start, cursor);
+        }
+
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         glfwSwapBuffers(window);
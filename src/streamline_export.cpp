@@ -0,0 +1,366 @@
+#include "streamline_export.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <sys/stat.h>
+
+namespace{
+
+const size_t OUT_BUF_SIZE = 1 << 22;     // 4MB 輸出緩衝
+const size_t CHUNK = 1 << 14;            // 讀回暫存檔 / 產生 index 時的批次大小
+
+bool host_little_endian(){
+    const uint16_t one = 1;
+    unsigned char b;
+    std::memcpy(&b, &one, 1);
+    return b == 1;
+}
+
+const char *byte_order_name(){
+    return host_little_endian() ? "LittleEndian" : "BigEndian";
+}
+
+template<typename T>
+void write_pod(FILE *f, const T &v){
+    fwrite(&v, sizeof(T), 1, f);
+}
+
+// 只刪一般檔案，輸出是 device 之類的就不動
+void remove_partial(const std::string &path){
+    struct stat st;
+    if(stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG){
+        std::remove(path.c_str());
+    }
+}
+
+// 固定寬度，讓檔頭在回填前後長度一致
+std::string fixed_num(uint64_t v){
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%020llu", (unsigned long long) v);
+    return buf;
+}
+
+}
+
+streamline_writer::~streamline_writer(){
+    if(out) fclose(out);
+    if(spill) fclose(spill);
+}
+
+bool streamline_writer::open(const std::string &file){
+    // 上一個檔案還沒 close() 就不能再開，不然會漏掉 FILE 且上一個檔沒收尾
+    if(out){
+        std::cerr << "Export writer is still open on " << path << ", close() it first" << std::endl;
+        return false;
+    }
+    path = file;
+    out = fopen(path.c_str(), "wb");
+    if(!out){
+        std::cerr << "Failed to open export file: " << path << std::endl;
+        return false;
+    }
+    // close() 要回頭改檔頭，pipe 之類不能 seek 的輸出直接拒絕
+    if(fseek(out, 0, SEEK_SET) != 0){
+        std::cerr << "Export output must be a seekable file: " << path << std::endl;
+        fclose(out);
+        out = nullptr;
+        return false;
+    }
+    setvbuf(out, nullptr, _IOFBF, OUT_BUF_SIZE);
+    spill = std::tmpfile();
+    if(!spill){
+        std::cerr << "Failed to create temporary file for export" << std::endl;
+        fclose(out);
+        out = nullptr;
+        return false;
+    }
+    setvbuf(spill, nullptr, _IOFBF, OUT_BUF_SIZE);
+    reset();
+    write_header();
+    return true;
+}
+
+void streamline_writer::reset(){
+    line_cnt = point_cnt = 0;
+    failed = false;
+}
+
+void streamline_writer::add_line(const std::vector<glm::vec2> &pts, float seed_grad){
+    if(failed) return;
+    float length = 0.0f;
+    for(size_t i = 1; i < pts.size(); i++){
+        length += glm::length(pts[i] - pts[i - 1]);
+    }
+    write_points(pts, seed_grad);
+    if(failed) return;
+    line_record rec{ (uint64_t) pts.size(), seed_grad, length };
+    // 磁碟滿之類的短寫入，馬上停下來，不要等到 close() 才發現
+    if(fwrite(&rec, sizeof(rec), 1, spill) != 1 || ferror(out) || ferror(spill)){
+        std::cerr << "Failed to write export file: " << path << std::endl;
+        failed = true;
+        return;
+    }
+    line_cnt++;
+    point_cnt += pts.size();
+}
+
+bool streamline_writer::close(){
+    if(!out) return false;
+    if(failed){
+        fclose(out);
+        fclose(spill);
+        out = spill = nullptr;
+        remove_partial(path);
+        return false;
+    }
+    fflush(spill);
+    write_tail();
+    // 回到檔頭填入最終數量
+    bool seek_ok = fseek(out, 0, SEEK_SET) == 0;
+    if(seek_ok) write_header();
+    else std::cerr << "Export output must be a seekable file: " << path << std::endl;
+    bool ok = seek_ok && !ferror(out) && !ferror(spill);
+    ok = (fclose(out) == 0) && ok;
+    fclose(spill);
+    out = spill = nullptr;
+    if(!ok){
+        std::cerr << "Failed to write export file: " << path << std::endl;
+        remove_partial(path);
+    }
+    return ok;
+}
+
+template<typename F>
+void streamline_writer::for_each_record(F &&fn){
+    std::vector<line_record> buf(CHUNK);
+    rewind(spill);
+    size_t n;
+    while((n = fread(buf.data(), sizeof(line_record), buf.size(), spill)) > 0){
+        for(size_t i = 0; i < n; i++) fn(buf[i]);
+    }
+}
+
+
+// ---------------- VTK ----------------
+
+void vtk_writer::write_header(){
+    // appended 區塊依序為 points, connectivity, offsets, seed_grad, length
+    // 每個區塊前面有 UInt64 的 byte 數
+    uint64_t points_bytes = point_cnt * 3 * sizeof(float);
+    uint64_t conn_off = sizeof(uint64_t) + points_bytes;
+    uint64_t offs_off = conn_off + sizeof(uint64_t) + point_cnt * sizeof(int64_t);
+    uint64_t grad_off = offs_off + sizeof(uint64_t) + line_cnt * sizeof(int64_t);
+    uint64_t len_off = grad_off + sizeof(uint64_t) + line_cnt * sizeof(float);
+
+    std::string s;
+    s += "<?xml version=\"1.0\"?>\n";
+    s += std::string("<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"")
+        + byte_order_name() + "\" header_type=\"UInt64\">\n";
+    s += "  <PolyData>\n";
+    s += "    <Piece NumberOfPoints=\"" + fixed_num(point_cnt)
+        + "\" NumberOfVerts=\"0\" NumberOfLines=\"" + fixed_num(line_cnt)
+        + "\" NumberOfStrips=\"0\" NumberOfPolys=\"0\">\n";
+    s += "      <Points>\n";
+    s += "        <DataArray type=\"Float32\" NumberOfComponents=\"3\" format=\"appended\" offset=\"0\"/>\n";
+    s += "      </Points>\n";
+    s += "      <Lines>\n";
+    s += "        <DataArray type=\"Int64\" Name=\"connectivity\" format=\"appended\" offset=\""
+        + fixed_num(conn_off) + "\"/>\n";
+    s += "        <DataArray type=\"Int64\" Name=\"offsets\" format=\"appended\" offset=\""
+        + fixed_num(offs_off) + "\"/>\n";
+    s += "      </Lines>\n";
+    s += "      <CellData Scalars=\"seed_grad\">\n";
+    s += "        <DataArray type=\"Float32\" Name=\"seed_grad\" format=\"appended\" offset=\""
+        + fixed_num(grad_off) + "\"/>\n";
+    s += "        <DataArray type=\"Float32\" Name=\"length\" format=\"appended\" offset=\""
+        + fixed_num(len_off) + "\"/>\n";
+    s += "      </CellData>\n";
+    s += "    </Piece>\n";
+    s += "  </PolyData>\n";
+    s += "  <AppendedData encoding=\"raw\">\n";
+    s += "_";
+    fwrite(s.data(), 1, s.size(), out);
+    write_pod(out, points_bytes);
+}
+
+void vtk_writer::write_points(const std::vector<glm::vec2> &pts, float){
+    scratch.resize(pts.size() * 3);
+    for(size_t i = 0; i < pts.size(); i++){
+        scratch[i * 3 + 0] = pts[i].x;
+        scratch[i * 3 + 1] = pts[i].y;
+        scratch[i * 3 + 2] = 0.0f;
+    }
+    fwrite(scratch.data(), sizeof(float), scratch.size(), out);
+}
+
+void vtk_writer::write_tail(){
+    // connectivity 就是 0..N-1
+    write_pod(out, (uint64_t) (point_cnt * sizeof(int64_t)));
+    std::vector<int64_t> idx(CHUNK);
+    for(uint64_t base = 0; base < point_cnt; base += CHUNK){
+        size_t n = (size_t) std::min<uint64_t>(CHUNK, point_cnt - base);
+        for(size_t i = 0; i < n; i++) idx[i] = (int64_t) (base + i);
+        fwrite(idx.data(), sizeof(int64_t), n, out);
+    }
+
+    write_pod(out, (uint64_t) (line_cnt * sizeof(int64_t)));
+    int64_t end = 0;
+    for_each_record([&](const line_record &r){
+        end += (int64_t) r.vert_cnt;
+        write_pod(out, end);
+    });
+
+    write_pod(out, (uint64_t) (line_cnt * sizeof(float)));
+    for_each_record([&](const line_record &r){ write_pod(out, r.seed_grad); });
+
+    write_pod(out, (uint64_t) (line_cnt * sizeof(float)));
+    for_each_record([&](const line_record &r){ write_pod(out, r.length); });
+
+    const char footer[] = "\n  </AppendedData>\n</VTKFile>\n";
+    fwrite(footer, 1, sizeof(footer) - 1, out);
+}
+
+
+// ---------------- PLY ----------------
+
+void ply_writer::write_header(){
+    std::string s;
+    s += "ply\n";
+    s += std::string("format ") + (host_little_endian() ? "binary_little_endian" : "binary_big_endian") + " 1.0\n";
+    s += "comment streamlines, one edge per segment\n";
+    s += "element vertex " + fixed_num(point_cnt) + "\n";
+    s += "property float x\n";
+    s += "property float y\n";
+    s += "property float z\n";
+    s += "property float seed_grad\n";
+    s += "property uint line\n";
+    s += "element edge " + fixed_num(edge_cnt) + "\n";
+    s += "property uint vertex1\n";
+    s += "property uint vertex2\n";
+    s += "end_header\n";
+    fwrite(s.data(), 1, s.size(), out);
+}
+
+void ply_writer::reset(){
+    streamline_writer::reset();
+    edge_cnt = 0;
+}
+
+void ply_writer::write_points(const std::vector<glm::vec2> &pts, float seed_grad){
+    if(point_cnt + pts.size() > UINT32_MAX || line_cnt >= UINT32_MAX){
+        std::cerr << "PLY export is limited to 2^32 points and lines, use .vtp or .slr instead" << std::endl;
+        failed = true;
+        return;
+    }
+    // x, y, z, seed_grad, line 各 4 bytes
+    scratch.resize(pts.size() * 5);
+    uint32_t line = (uint32_t) line_cnt;
+    for(size_t i = 0; i < pts.size(); i++){
+        float *v = &scratch[i * 5];
+        v[0] = pts[i].x;
+        v[1] = pts[i].y;
+        v[2] = 0.0f;
+        v[3] = seed_grad;
+        std::memcpy(&v[4], &line, sizeof(line));
+    }
+    fwrite(scratch.data(), sizeof(float), scratch.size(), out);
+    if(!pts.empty()) edge_cnt += pts.size() - 1;
+}
+
+void ply_writer::write_tail(){
+    uint32_t base = 0;
+    for_each_record([&](const line_record &r){
+        for(uint64_t i = 1; i < r.vert_cnt; i++){
+            uint32_t e[2] = { base + (uint32_t) i - 1, base + (uint32_t) i };
+            fwrite(e, sizeof(uint32_t), 2, out);
+        }
+        base += (uint32_t) r.vert_cnt;
+    });
+}
+
+
+// ---------------- raw ----------------
+
+void raw_writer::write_header(){
+    const char magic[8] = { 'S', 'L', 'R', 'A', 'W', '0', '1', '\0' };
+    fwrite(magic, 1, sizeof(magic), out);
+    write_pod(out, line_cnt);
+    write_pod(out, point_cnt);
+}
+
+void raw_writer::write_points(const std::vector<glm::vec2> &pts, float){
+    scratch.resize(pts.size() * 2);
+    for(size_t i = 0; i < pts.size(); i++){
+        scratch[i * 2 + 0] = pts[i].x;
+        scratch[i * 2 + 1] = pts[i].y;
+    }
+    fwrite(scratch.data(), sizeof(float), scratch.size(), out);
+}
+
+void raw_writer::write_tail(){
+    uint64_t off = 0;
+    write_pod(out, off);
+    for_each_record([&](const line_record &r){
+        off += r.vert_cnt;
+        write_pod(out, off);
+    });
+    for_each_record([&](const line_record &r){ write_pod(out, r.seed_grad); });
+    for_each_record([&](const line_record &r){ write_pod(out, r.length); });
+}
+
+
+std::unique_ptr<streamline_writer> make_streamline_writer(export_format fmt){
+    switch(fmt){
+    case export_format::vtk: return std::make_unique<vtk_writer>();
+    case export_format::ply: return std::make_unique<ply_writer>();
+    case export_format::raw: return std::make_unique<raw_writer>();
+    }
+    return nullptr;
+}
+
+bool parse_export_format(const std::string &name, export_format &fmt){
+    if(name == "vtk" || name == "vtp") fmt = export_format::vtk;
+    else if(name == "ply") fmt = export_format::ply;
+    else if(name == "raw" || name == "slr") fmt = export_format::raw;
+    else return false;
+    return true;
+}
+
+export_format export_format_from_path(const std::string &path){
+    export_format fmt = export_format::vtk;
+    size_t dot = path.find_last_of('.');
+    if(dot != std::string::npos) parse_export_format(path.substr(dot + 1), fmt);
+    return fmt;
+}
+
+const char *export_format_ext(export_format fmt){
+    switch(fmt){
+    case export_format::vtk: return "vtp";
+    case export_format::ply: return "ply";
+    case export_format::raw: return "slr";
+    }
+    return "vtp";
+}
+
+bool export_streamlines(const vector_field &vf, const std::string &path, export_format fmt,
+    int seed_cols, int seed_rows, float h, int maxSteps){
+    auto writer = make_streamline_writer(fmt);
+    if(!writer || !writer->open(path)) return false;
+
+    for(int j = 0; j < seed_rows; j++){
+        float fy = (j + 0.5f) * vf.get_height() / float(seed_rows);
+        for(int i = 0; i < seed_cols; i++){
+            float fx = (i + 0.5f) * vf.get_width() / float(seed_cols);
+            auto line = integrate_streamline(vf, { fx, fy }, h, maxSteps);
+            writer->add_line(line, vf.seed_gradient({ fx, fy }));
+        }
+        if(writer->has_failed()) break;
+    }
+
+    uint64_t lines = writer->get_line_count(), points = writer->get_point_count();
+    if(!writer->close()) return false;
+    // 走 stderr，不要混進輸出資料
+    std::cerr << "exported " << lines << " lines, " << points << " points to " << path << std::endl;
+    return true;
+}
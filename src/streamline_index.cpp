@@ -0,0 +1,342 @@
+#include "streamline_index.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <thread>
+
+namespace{
+
+const int MAX_GRID = 4096;          // 每軸最多幾格
+const float FAR = 1e30f;            // 邊界格往外延伸，場外的點也落在邊界格
+const float CELL_EPS = 1e-3f;       // 線段插入格子時的餘量 (格子大小的比例)
+const size_t PARALLEL_MIN = 1 << 16; // 太少就不開 thread
+
+// fn(begin, end)，切成 hardware_concurrency 份
+template<typename F>
+void parallel_for(size_t n, F &&fn){
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    if(n < PARALLEL_MIN) threads = 1;
+    size_t chunk = (n + threads - 1) / threads;
+    std::vector<std::future<void>> jobs;
+    for(size_t b = 0; b < n; b += chunk){
+        size_t e = std::min(n, b + chunk);
+        jobs.push_back(std::async(std::launch::async, [&fn, b, e]{ fn(b, e); }));
+    }
+    for(auto &j : jobs) j.get();
+}
+
+float seg_dist2(glm::vec2 p, glm::vec2 a, glm::vec2 b){
+    glm::vec2 ab = b - a;
+    float len2 = glm::dot(ab, ab);
+    float t = len2 > 0.0f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f) : 0.0f;
+    glm::vec2 d = a + ab * t - p;
+    return glm::dot(d, d);
+}
+
+// Liang-Barsky
+bool seg_hits_rect(glm::vec2 a, glm::vec2 b, glm::vec2 lo, glm::vec2 hi){
+    float t0 = 0.0f, t1 = 1.0f;
+    glm::vec2 d = b - a;
+    auto clip = [&](float p, float q){
+        if(p == 0.0f) return q >= 0.0f;
+        float r = q / p;
+        if(p < 0.0f){
+            if(r > t1) return false;
+            t0 = std::max(t0, r);
+        }
+        else{
+            if(r < t0) return false;
+            t1 = std::min(t1, r);
+        }
+        return true;
+    };
+    return clip(-d.x, a.x - lo.x) && clip(d.x, hi.x - a.x) &&
+        clip(-d.y, a.y - lo.y) && clip(d.y, hi.y - a.y);
+}
+
+}
+
+template<typename F>
+void streamline_index::for_each_cell(glm::vec2 lo, glm::vec2 hi, F &&fn) const{
+    int x0 = glm::clamp(int(std::floor(lo.x * inv_cell)), 0, nx - 1);
+    int x1 = glm::clamp(int(std::floor(hi.x * inv_cell)), 0, nx - 1);
+    int y0 = glm::clamp(int(std::floor(lo.y * inv_cell)), 0, ny - 1);
+    int y1 = glm::clamp(int(std::floor(hi.y * inv_cell)), 0, ny - 1);
+    for(int y = y0; y <= y1; y++)
+        for(int x = x0; x <= x1; x++)
+            fn(y * nx + x);
+}
+
+template<typename F>
+void streamline_index::for_each_seg_cell(glm::vec2 a, glm::vec2 b, F &&fn) const{
+    glm::vec2 lo = glm::min(a, b), hi = glm::max(a, b);
+    int x0 = glm::clamp(int(std::floor(lo.x * inv_cell)), 0, nx - 1);
+    int x1 = glm::clamp(int(std::floor(hi.x * inv_cell)), 0, nx - 1);
+    int y0 = glm::clamp(int(std::floor(lo.y * inv_cell)), 0, ny - 1);
+    int y1 = glm::clamp(int(std::floor(hi.y * inv_cell)), 0, ny - 1);
+    if(x0 == x1 && y0 == y1){
+        fn(y0 * nx + x0);
+        return;
+    }
+    // 斜的長線段 AABB 會蓋到很多它沒經過的格子，逐格測一下；邊留一點餘量避免浮點誤差漏掉
+    float eps = cell_size * CELL_EPS;
+    for(int y = y0; y <= y1; y++){
+        float cy0 = y == 0 ? -FAR : y * cell_size - eps;
+        float cy1 = y == ny - 1 ? FAR : (y + 1) * cell_size + eps;
+        for(int x = x0; x <= x1; x++){
+            float cx0 = x == 0 ? -FAR : x * cell_size - eps;
+            float cx1 = x == nx - 1 ? FAR : (x + 1) * cell_size + eps;
+            if(seg_hits_rect(a, b, { cx0, cy0 }, { cx1, cy1 })) fn(y * nx + x);
+        }
+    }
+}
+
+void streamline_index::build(std::vector<glm::vec2> verts, const std::vector<int> &vert_cnt,
+    float w, float h){
+    field_w = std::max(w, 1.0f);
+    field_h = std::max(h, 1.0f);
+    vbo_cnt = vert_cnt;
+    vbo_first.resize(vbo_cnt.size());
+    int first = 0;
+    for(size_t l = 0; l < vbo_cnt.size(); l++){
+        vbo_first[l] = first;
+        first += vbo_cnt[l];
+    }
+    vbo_stale.assign(vbo_cnt.size(), 0);
+    build_grid(std::move(verts), vert_cnt);
+}
+
+void streamline_index::build_grid(std::vector<glm::vec2> verts, const std::vector<int> &vert_cnt){
+    pts = std::move(verts);
+    line_cnt = vert_cnt;
+    line_first.resize(line_cnt.size());
+    vert_line.resize(pts.size());
+    int first = 0;
+    for(size_t l = 0; l < line_cnt.size(); l++){
+        line_first[l] = first;
+        std::fill(vert_line.begin() + first, vert_line.begin() + first + line_cnt[l], (uint32_t) l);
+        first += line_cnt[l];
+    }
+    dirty.assign(line_cnt.size(), 0);
+    seen.assign(line_cnt.size(), 0);
+    seen_gen = 0;
+    patch_pts.clear();
+    patch_cells.clear();
+    patch_seg_cnt = 0;
+
+    // 線段 k = (pts[k], pts[k + 1])，兩點同一條線才算
+    auto is_seg = [this](size_t k){ return k + 1 < pts.size() && vert_line[k] == vert_line[k + 1]; };
+    base_seg_cnt = 0;
+    double extent_sum = 0.0;
+    for(size_t k = 0; k < pts.size(); k++){
+        if(!is_seg(k)) continue;
+        glm::vec2 d = pts[k + 1] - pts[k];
+        extent_sum += std::max(std::abs(d.x), std::abs(d.y));
+        base_seg_cnt++;
+    }
+
+    // 每格平均約 4 條線段，但格子至少和線段的平均長度一樣大，
+    // 不然 step 大的時候一條線段要塞進一大堆格子
+    float cell = std::sqrt(field_w * field_h * 4.0f / float(std::max<size_t>(base_seg_cnt, 1)));
+    cell = std::max(cell, float(extent_sum / double(std::max<size_t>(base_seg_cnt, 1))));
+    cell = std::max(cell, std::max(field_w, field_h) / MAX_GRID);
+    cell_size = cell;
+    inv_cell = 1.0f / cell;
+    nx = std::max(1, int(std::ceil(field_w * inv_cell)));
+    ny = std::max(1, int(std::ceil(field_h * inv_cell)));
+    size_t cells = size_t(nx) * ny;
+
+    // 先數每格幾條，prefix sum 後再平行填入
+    std::vector<std::atomic<uint32_t>> cursor(cells);
+    parallel_for(pts.size(), [&](size_t b, size_t e){
+        for(size_t k = b; k < e; k++){
+            if(!is_seg(k)) continue;
+            for_each_seg_cell(pts[k], pts[k + 1],
+                [&](int c){ cursor[c].fetch_add(1, std::memory_order_relaxed); });
+        }
+    });
+    cell_start.assign(cells + 1, 0);
+    for(size_t c = 0; c < cells; c++){
+        uint32_t n = cursor[c].load(std::memory_order_relaxed);
+        cell_start[c + 1] = cell_start[c] + n;
+        cursor[c].store(cell_start[c], std::memory_order_relaxed);
+    }
+    cell_segs.resize(cell_start[cells]);
+    parallel_for(pts.size(), [&](size_t b, size_t e){
+        for(size_t k = b; k < e; k++){
+            if(!is_seg(k)) continue;
+            for_each_seg_cell(pts[k], pts[k + 1],
+                [&](int c){ cell_segs[cursor[c].fetch_add(1, std::memory_order_relaxed)] = (uint32_t) k; });
+        }
+    });
+}
+
+void streamline_index::insert_patch(int line){
+    const auto &lp = patch_pts[line];
+    for(size_t s = 0; s + 1 < lp.size(); s++){
+        for_each_seg_cell(lp[s], lp[s + 1],
+            [&](int c){ patch_cells[c].push_back({ line, (int) s }); });
+        patch_seg_cnt++;
+    }
+}
+
+void streamline_index::erase_patch(int line){
+    auto it = patch_pts.find(line);
+    if(it == patch_pts.end()) return;
+    const auto &lp = it->second;
+    for(size_t s = 0; s + 1 < lp.size(); s++){
+        for_each_seg_cell(lp[s], lp[s + 1], [&](int c){
+            auto &v = patch_cells[c];
+            v.erase(std::remove_if(v.begin(), v.end(),
+                [line](const std::pair<int, int> &e){ return e.first == line; }), v.end());
+            if(v.empty()) patch_cells.erase(c);
+        });
+        patch_seg_cnt--;
+    }
+    patch_pts.erase(it);
+}
+
+void streamline_index::update_line(int line, std::vector<glm::vec2> new_pts){
+    if(line < 0 || line >= get_line_count()) return;
+    erase_patch(line);
+    dirty[line] = 1;
+    vbo_stale[line] = 1;
+    patch_pts[line] = std::move(new_pts);
+    insert_patch(line);
+
+    if(patch_seg_cnt * 4 <= base_seg_cnt + 1024) return;
+
+    // patch 太多，把目前的線重新排成一份 base
+    std::vector<glm::vec2> verts;
+    std::vector<int> cnt(line_cnt.size());
+    verts.reserve(pts.size() + patch_seg_cnt);
+    for(int l = 0; l < get_line_count(); l++){
+        auto lp = get_line_points(l);
+        verts.insert(verts.end(), lp.first, lp.first + lp.second);
+        cnt[l] = lp.second;
+    }
+    build_grid(std::move(verts), cnt);
+}
+
+int streamline_index::nearest_line(glm::vec2 p, float max_dist, float *out_dist) const{
+    if(line_cnt.empty()) return -1;
+    float best = max_dist * max_dist;
+    int best_line = -1;
+    auto visit = [&](int c){
+        for(uint32_t i = cell_start[c]; i < cell_start[c + 1]; i++){
+            uint32_t k = cell_segs[i];
+            if(dirty[vert_line[k]]) continue;
+            float d = seg_dist2(p, pts[k], pts[k + 1]);
+            if(d < best){
+                best = d;
+                best_line = (int) vert_line[k];
+            }
+        }
+        if(patch_cells.empty()) return;
+        auto it = patch_cells.find(c);
+        if(it == patch_cells.end()) return;
+        for(const auto &e : it->second){
+            const auto &lp = patch_pts.at(e.first);
+            float d = seg_dist2(p, lp[e.second], lp[e.second + 1]);
+            if(d < best){
+                best = d;
+                best_line = e.first;
+            }
+        }
+    };
+
+    // 從 p 所在的格子一圈一圈往外找，剩下的圈都比目前最近的還遠就停
+    int cx = glm::clamp(int(std::floor(p.x * inv_cell)), 0, nx - 1);
+    int cy = glm::clamp(int(std::floor(p.y * inv_cell)), 0, ny - 1);
+    glm::vec2 cell_lo(cx * cell_size, cy * cell_size);
+    glm::vec2 to_lo = p - cell_lo, to_hi = cell_lo + glm::vec2(cell_size, cell_size) - p;
+    float edge = std::max(0.0f, std::min(std::min(to_lo.x, to_lo.y), std::min(to_hi.x, to_hi.y)));
+    int rings = int(std::ceil(max_dist * inv_cell)) + 1;
+    rings = std::min(rings, std::max(nx, ny));
+    for(int k = 0; k <= rings; k++){
+        if(k > 0){
+            float lb = (k - 1) * cell_size + edge;
+            if(lb * lb >= best) break;
+        }
+        int x0 = cx - k, x1 = cx + k, y0 = cy - k, y1 = cy + k;
+        for(int y = std::max(y0, 0); y <= std::min(y1, ny - 1); y++){
+            if(y == y0 || y == y1){
+                for(int x = std::max(x0, 0); x <= std::min(x1, nx - 1); x++) visit(y * nx + x);
+            }
+            else{
+                if(x0 >= 0) visit(y * nx + x0);
+                if(x1 < nx) visit(y * nx + x1);
+            }
+        }
+    }
+    if(out_dist && best_line >= 0) *out_dist = std::sqrt(best);
+    return best_line;
+}
+
+std::vector<int> streamline_index::lines_in_rect(glm::vec2 a, glm::vec2 b) const{
+    std::vector<int> res;
+    if(line_cnt.empty()) return res;
+    glm::vec2 lo = glm::min(a, b), hi = glm::max(a, b);
+
+    // 已經收過的線剩下的線段直接跳過
+    if(++seen_gen == 0){
+        std::fill(seen.begin(), seen.end(), 0);
+        seen_gen = 1;
+    }
+    auto take = [&](int line){
+        seen[line] = seen_gen;
+        res.push_back(line);
+    };
+
+    float eps = cell_size * CELL_EPS;
+    int x0 = glm::clamp(int(std::floor(lo.x * inv_cell)), 0, nx - 1);
+    int x1 = glm::clamp(int(std::floor(hi.x * inv_cell)), 0, nx - 1);
+    int y0 = glm::clamp(int(std::floor(lo.y * inv_cell)), 0, ny - 1);
+    int y1 = glm::clamp(int(std::floor(hi.y * inv_cell)), 0, ny - 1);
+    for(int y = y0; y <= y1; y++){
+        for(int x = x0; x <= x1; x++){
+            int c = y * nx + x;
+            // 整格 (含插入時的餘量) 都在矩形內就不用測；邊界格往外延伸，不算
+            bool inside = x > 0 && y > 0 && x < nx - 1 && y < ny - 1 &&
+                x * cell_size - eps >= lo.x && (x + 1) * cell_size + eps <= hi.x &&
+                y * cell_size - eps >= lo.y && (y + 1) * cell_size + eps <= hi.y;
+            for(uint32_t i = cell_start[c]; i < cell_start[c + 1]; i++){
+                uint32_t k = cell_segs[i];
+                uint32_t line = vert_line[k];
+                if(seen[line] == seen_gen || dirty[line]) continue;
+                if(inside || seg_hits_rect(pts[k], pts[k + 1], lo, hi)) take((int) line);
+            }
+            if(patch_cells.empty()) continue;
+            auto it = patch_cells.find(c);
+            if(it == patch_cells.end()) continue;
+            for(const auto &e : it->second){
+                if(seen[e.first] == seen_gen) continue;
+                const auto &lp = patch_pts.at(e.first);
+                if(inside || seg_hits_rect(lp[e.second], lp[e.second + 1], lo, hi)) take(e.first);
+            }
+        }
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+std::pair<int, int> streamline_index::get_line_range(int line) const{
+    if(vbo_stale[line]) return { -1, 0 };
+    return { vbo_first[line], vbo_cnt[line] };
+}
+
+std::pair<const glm::vec2 *, int> streamline_index::get_line_points(int line) const{
+    if(dirty[line]){
+        const auto &lp = patch_pts.at(line);
+        return { lp.data(), (int) lp.size() };
+    }
+    return { pts.data() + line_first[line], line_cnt[line] };
+}
+
+float streamline_index::get_line_length(int line) const{
+    auto lp = get_line_points(line);
+    float len = 0.0f;
+    for(int i = 1; i < lp.second; i++) len += glm::length(lp.first[i] - lp.first[i - 1]);
+    return len;
+}
@@ -99,6 +99,11 @@ const glm::vec2 vector_field::get_min_max() const{
 const std::vector<std::vector<glm::vec2>> &vector_field::get_vector() const{
     return vectors;
 }
+float vector_field::seed_gradient(glm::vec2 seed) const{
+    int gi = glm::clamp(int(seed.y), 0, h - 1);
+    int gj = glm::clamp(int(seed.x), 0, w - 1);
+    return glm::length(gradients[gi][gj]);
+}
 
 std::vector<glm::vec2> integrate_streamline(const vector_field &vf, glm::vec2 seed,
     float h, int maxSteps){